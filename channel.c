@@ -0,0 +1,142 @@
+#include "channel.h"
+#include "err.h"
+#include <stdlib.h>
+
+int channel_init(channel_t *channel, size_t capacity) {
+    if (!capacity) return -1;
+
+    channel->buffer = malloc(sizeof(void *) * capacity);
+    if (!channel->buffer) return -1;
+
+    if (pthread_mutex_init(&channel->lock, 0) != 0) syserr("pthread_mutex_init error\n");
+    if (pthread_cond_init(&channel->not_empty, 0) != 0) syserr("pthread_cond_init error\n");
+    if (pthread_cond_init(&channel->not_full, 0) != 0) syserr("pthread_cond_init error\n");
+
+    channel->capacity = capacity;
+    channel->head = channel->count = 0;
+    channel->closed = 0;
+
+    return 0;
+}
+
+void channel_destroy(channel_t *channel) {
+    if (pthread_cond_destroy(&channel->not_full) != 0) syserr("pthread_cond_destroy error\n");
+    if (pthread_cond_destroy(&channel->not_empty) != 0) syserr("pthread_cond_destroy error\n");
+    if (pthread_mutex_destroy(&channel->lock) != 0) syserr("pthread_mutex_destroy error\n");
+
+    free(channel->buffer);
+}
+
+void channel_push(channel_t *channel, void *item) {
+    channel->buffer[(channel->head + channel->count++) % channel->capacity] = item;
+}
+
+void *channel_pop(channel_t *channel) {
+    void *item = channel->buffer[channel->head];
+    channel->head = (channel->head + 1) % channel->capacity;
+    channel->count--;
+    return item;
+}
+
+size_t channel_send_batch(channel_t *channel, void **items, size_t count) {
+    size_t sent = 0;
+
+    if (pthread_mutex_lock(&channel->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    while (sent < count && !channel->closed) {
+        while (channel->count == channel->capacity && !channel->closed) {
+            if (pthread_cond_wait(&channel->not_full, &channel->lock) != 0) syserr("pthread_cond_wait error\n");
+        }
+        if (channel->closed) break;
+
+        size_t before = sent;
+        while (sent < count && channel->count < channel->capacity) channel_push(channel, items[sent++]);
+
+        if (sent - before > 1) {
+            if (pthread_cond_broadcast(&channel->not_empty) != 0) syserr("pthread_cond_broadcast error\n");
+        } else {
+            if (pthread_cond_signal(&channel->not_empty) != 0) syserr("pthread_cond_signal error\n");
+        }
+    }
+
+    if (pthread_mutex_unlock(&channel->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return sent;
+}
+
+size_t channel_recv_batch(channel_t *channel, void **items, size_t max) {
+    size_t received = 0;
+    if (!max) return 0;
+
+    if (pthread_mutex_lock(&channel->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    while (!channel->count && !channel->closed) {
+        if (pthread_cond_wait(&channel->not_empty, &channel->lock) != 0) syserr("pthread_cond_wait error\n");
+    }
+
+    while (received < max && channel->count) items[received++] = channel_pop(channel);
+
+    if (received > 1) {
+        if (pthread_cond_broadcast(&channel->not_full) != 0) syserr("pthread_cond_broadcast error\n");
+    } else if (received) {
+        if (pthread_cond_signal(&channel->not_full) != 0) syserr("pthread_cond_signal error\n");
+    }
+
+    if (pthread_mutex_unlock(&channel->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return received;
+}
+
+int channel_send(channel_t *channel, void *item) {
+    return (channel_send_batch(channel, &item, 1) == 1) ? 0 : -1;
+}
+
+int channel_recv(channel_t *channel, void **item) {
+    return (channel_recv_batch(channel, item, 1) == 1) ? 0 : -1;
+}
+
+int channel_try_send(channel_t *channel, void *item) {
+    int retval = 0;
+
+    if (pthread_mutex_lock(&channel->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (channel->closed) {
+        retval = -1;
+    } else if (channel->count == channel->capacity) {
+        retval = 1;
+    } else {
+        channel_push(channel, item);
+        if (pthread_cond_signal(&channel->not_empty) != 0) syserr("pthread_cond_signal error\n");
+    }
+
+    if (pthread_mutex_unlock(&channel->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return retval;
+}
+
+int channel_try_recv(channel_t *channel, void **item) {
+    int retval = 0;
+
+    if (pthread_mutex_lock(&channel->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (channel->count) {
+        *item = channel_pop(channel);
+        if (pthread_cond_signal(&channel->not_full) != 0) syserr("pthread_cond_signal error\n");
+    } else {
+        retval = channel->closed ? -1 : 1;
+    }
+
+    if (pthread_mutex_unlock(&channel->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return retval;
+}
+
+void channel_close(channel_t *channel) {
+    if (pthread_mutex_lock(&channel->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    channel->closed = 1;
+    if (pthread_cond_broadcast(&channel->not_empty) != 0) syserr("pthread_cond_broadcast error\n");
+    if (pthread_cond_broadcast(&channel->not_full) != 0) syserr("pthread_cond_broadcast error\n");
+
+    if (pthread_mutex_unlock(&channel->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
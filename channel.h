@@ -0,0 +1,43 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct channel {
+    void **buffer;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int8_t closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} channel_t;
+
+int channel_init(channel_t *channel, size_t capacity);
+
+void channel_destroy(channel_t *channel);
+
+// Sending fails with -1 once the channel is closed; receiving fails with -1 once it is closed and drained. The try
+// variants return 1 instead of blocking.
+int channel_send(channel_t *channel, void *item);
+
+int channel_try_send(channel_t *channel, void *item);
+
+int channel_recv(channel_t *channel, void **item);
+
+int channel_try_recv(channel_t *channel, void **item);
+
+// Batch operations take the lock once per wake-up rather than once per item. channel_send_batch blocks until all count
+// items are queued and returns how many were, which is fewer only if the channel was closed. channel_recv_batch blocks
+// until at least one item is available and returns up to max of them, or 0 once the channel is closed and drained.
+// With max or count 0 both return 0 at once without blocking.
+size_t channel_send_batch(channel_t *channel, void **items, size_t count);
+
+size_t channel_recv_batch(channel_t *channel, void **items, size_t max);
+
+void channel_close(channel_t *channel);
+
+#endif
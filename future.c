@@ -10,20 +10,27 @@ typedef struct async_data {
 } async_data_t;
 
 typedef struct map_data {
+    thread_pool_t *pool;
     future_t *future;
     future_t *from;
     function_t function;
+    struct map_data *next;
 } map_data_t;
 
+void map_call(void *arg, size_t argsz);
+
 void async_data_init(async_data_t *async_data, callable_t callable, future_t *future) {
     async_data->callable = callable;
     async_data->future = future;
 }
 
-void map_data_init(map_data_t *map_data, future_t *future, future_t *from, function_t function) {
+void map_data_init(map_data_t *map_data, thread_pool_t *pool, future_t *future, future_t *from,
+                   function_t function) {
+    map_data->pool = pool;
     map_data->future = future;
     map_data->from = from;
     map_data->function = function;
+    map_data->next = NULL;
 }
 
 void future_init(future_t *future) {
@@ -32,6 +39,11 @@ void future_init(future_t *future) {
 
     future->ready = 0;
     future->retval = NULL;
+    atomic_init(&future->refcount, 0);
+    future->destructor = NULL;
+    future->cache = NULL;
+    future->next = NULL;
+    future->continuations = NULL;
 }
 
 void future_destroy(future_t *future) {
@@ -39,31 +51,162 @@ void future_destroy(future_t *future) {
     if (pthread_mutex_destroy(&future->lock) != 0) syserr("pthread_mutex_destory error\n");
 }
 
+future_cache_t *future_cache_create() {
+    future_cache_t *cache = malloc(sizeof(future_cache_t));
+    if (!cache) return NULL;
+
+    if (pthread_mutex_init(&cache->lock, 0) != 0) syserr("pthread_mutex_init error\n");
+    cache->free_futures = NULL;
+    cache->refcount = 1;
+    cache->closed = 0;
+
+    return cache;
+}
+
+void future_cache_free_all(future_cache_t *cache) {
+    future_t *future = cache->free_futures;
+    while (future) {
+        future_t *next = future->next;
+        future_destroy(future);
+        free(future);
+        future = next;
+    }
+    cache->free_futures = NULL;
+}
+
+// Drops one reference to the cache, which the caller holds locked, and frees the cache if it was the last one.
+void future_cache_unref_unlock(future_cache_t *cache) {
+    int8_t last = --cache->refcount == 0;
+
+    if (pthread_mutex_unlock(&cache->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    if (last) {
+        if (pthread_mutex_destroy(&cache->lock) != 0) syserr("pthread_mutex_destroy error\n");
+        free(cache);
+    }
+}
+
+// Called when the pool is destroyed. Shared futures still alive keep the cache until they are released, after which
+// they are freed instead of being cached.
+void future_cache_close(future_cache_t *cache) {
+    if (pthread_mutex_lock(&cache->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    cache->closed = 1;
+    future_cache_free_all(cache);
+
+    future_cache_unref_unlock(cache);
+}
+
+// Futures on the freelist keep their mutex and condition variable initialised, so reuse only resets the state. Every
+// shared future holds a reference to the cache it came from.
+future_t *future_alloc(thread_pool_t *pool, size_t refcount, void (*destructor)(void *)) {
+    future_cache_t *cache = pool->future_cache;
+
+    if (pthread_mutex_lock(&cache->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    future_t *future = cache->free_futures;
+    if (future) cache->free_futures = future->next;
+    cache->refcount++;
+
+    if (pthread_mutex_unlock(&cache->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    if (!future) {
+        future = malloc(sizeof(future_t));
+        if (!future) {
+            if (pthread_mutex_lock(&cache->lock) != 0) syserr("pthread_mutex_lock error\n");
+            future_cache_unref_unlock(cache);
+            return NULL;
+        }
+        future_init(future);
+    }
+
+    future->ready = 0;
+    future->retval = NULL;
+    atomic_store_explicit(&future->refcount, refcount, memory_order_relaxed);
+    future->destructor = destructor;
+    future->cache = cache;
+    future->continuations = NULL;
+
+    return future;
+}
+
+void future_release(future_t *future) {
+    future_cache_t *cache = future->cache;
+
+    if (pthread_mutex_lock(&cache->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (cache->closed) {
+        future_destroy(future);
+        free(future);
+    } else {
+        future->next = cache->free_futures;
+        cache->free_futures = future;
+    }
+
+    future_cache_unref_unlock(cache);
+}
+
+void future_ref(future_t *future) {
+    atomic_fetch_add_explicit(&future->refcount, 1, memory_order_relaxed);
+}
+
+void future_unref(future_t *future) {
+    if (atomic_fetch_sub_explicit(&future->refcount, 1, memory_order_acq_rel) != 1) return;
+
+    if (future->ready && future->destructor) future->destructor(future->retval);
+    future_release(future);
+}
+
+// The pool of a waiting map is retained until the map has been queued on it. A map that still cannot be queued, e.g.
+// after SIGINT, runs on the completing thread instead, so that it still completes.
+void map_schedule(map_data_t *map_data) {
+    thread_pool_t *pool = map_data->pool;
+
+    if (defer(pool, (runnable_t) {.function = map_call, .arg = map_data, .argsz = 0}) != 0) {
+        map_call(map_data, 0);
+    }
+    thread_pool_release(pool);
+}
+
+void future_complete(future_t *future, void *retval) {
+    if (pthread_mutex_lock(&future->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    future->retval = retval;
+    future->ready = 1;
+    map_data_t *continuation = future->continuations;
+    future->continuations = NULL;
+
+    if (pthread_cond_broadcast(&future->cond) != 0) syserr("pthread_cond_broadcast error\n");
+    if (pthread_mutex_unlock(&future->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    while (continuation) {
+        map_data_t *next = continuation->next;
+        map_schedule(continuation);
+        continuation = next;
+    }
+}
+
+// Shared futures hold an extra reference on behalf of the task producing them, which drops it after completion.
 void async_call(void *arg, __attribute__((unused)) size_t argsz) {
     async_data_t *async_data = (async_data_t *) arg;
+    future_t *future = async_data->future;
+    int8_t shared = future->cache != NULL;
     size_t discard;
 
-    if (pthread_mutex_lock(&async_data->future->lock) != 0) syserr("pthread_mutex_lock error\n");
-
-    async_data->future->retval =
-            (void *) async_data->callable.function(async_data->callable.arg, async_data->callable.argsz, &discard);
-    async_data->future->ready = 1;
-
-    if (pthread_cond_broadcast(&async_data->future->cond) != 0) syserr("pthread_cond_broadcast error\n");
-    if (pthread_mutex_unlock(&async_data->future->lock) != 0) syserr("pthread_mutex_unlock error\n");
+    future_complete(future, async_data->callable.function(async_data->callable.arg, async_data->callable.argsz,
+                                                          &discard));
+    if (shared) future_unref(future);
     free(async_data);
 }
 
-int async(thread_pool_t *pool, future_t *future, callable_t callable) {
+int async_submit(thread_pool_t *pool, future_t *future, callable_t callable) {
     async_data_t *async_data = malloc(sizeof(async_data_t));
     if (!async_data) return -1;
 
-    future_init(future);
     async_data_init(async_data, callable, future);
 
     if (defer(pool,
               (runnable_t) {.function = async_call, .arg = async_data, .argsz = sizeof(*async_data)}) != 0) {
-        future_destroy(future);
         free(async_data);
         return -1;
     }
@@ -71,6 +214,29 @@ int async(thread_pool_t *pool, future_t *future, callable_t callable) {
     return 0;
 }
 
+int async(thread_pool_t *pool, future_t *future, callable_t callable) {
+    future_init(future);
+
+    if (async_submit(pool, future, callable) != 0) {
+        future_destroy(future);
+        return -1;
+    }
+
+    return 0;
+}
+
+future_t *async_shared(thread_pool_t *pool, callable_t callable, void (*destructor)(void *)) {
+    future_t *future = future_alloc(pool, 2, destructor);
+    if (!future) return NULL;
+
+    if (async_submit(pool, future, callable) != 0) {
+        future_release(future);
+        return NULL;
+    }
+
+    return future;
+}
+
 void *await(future_t *future) {
     if (pthread_mutex_lock(&future->lock) != 0) syserr("pthread_mutex_lock error\n");
 
@@ -85,27 +251,42 @@ void *await(future_t *future) {
 
 void map_call(void *arg, __attribute__((unused)) size_t argsz) {
     map_data_t *map_data = (map_data_t *) arg;
+    future_t *future = map_data->future;
+    future_t *from = map_data->from;
+    int8_t shared = future->cache != NULL;
+    int8_t shared_from = from->cache != NULL;
     size_t discard;
 
-    if (pthread_mutex_lock(&map_data->future->lock) != 0) syserr("pthread_mutex_lock error\n");
-
-    map_data->future->retval = (void *) map_data->function(await(map_data->from), 0, &discard);
-    map_data->future->ready = 1;
-
-    if (pthread_cond_broadcast(&map_data->future->cond) != 0) syserr("pthread_cond_broadcast error\n");
-    if (pthread_mutex_unlock(&map_data->future->lock) != 0) syserr("pthread_mutex_unlock error\n");
+    future_complete(future, map_data->function(await(from), 0, &discard));
+    if (shared_from) future_unref(from);
+    if (shared) future_unref(future);
     free(map_data);
 }
 
-int map(thread_pool_t *pool, future_t *future, future_t *from, function_t function) {
+// The map is only queued once from is ready; until then it waits on from's list of continuations instead of keeping
+// a worker blocked in await.
+int map_submit(thread_pool_t *pool, future_t *future, future_t *from, function_t function) {
     map_data_t *map_data = malloc(sizeof(map_data_t));
     if (!map_data) return -1;
 
-    future_init(future);
-    map_data_init(map_data, future, from, function);
+    map_data_init(map_data, pool, future, from, function);
+    if (from->cache) future_ref(from);
+
+    if (pthread_mutex_lock(&from->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    int8_t ready = from->ready;
+    if (!ready) {
+        thread_pool_retain(pool);
+        map_data->next = from->continuations;
+        from->continuations = map_data;
+    }
+
+    if (pthread_mutex_unlock(&from->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    if (!ready) return 0;
 
     if (defer(pool, (runnable_t) {.function = map_call, .arg = map_data, .argsz = 0}) != 0) {
-        future_destroy(future);
+        if (from->cache) future_unref(from);
         free(map_data);
         return -1;
     }
@@ -113,4 +294,25 @@ int map(thread_pool_t *pool, future_t *future, future_t *from, function_t functi
     return 0;
 }
 
+int map(thread_pool_t *pool, future_t *future, future_t *from, function_t function) {
+    future_init(future);
+
+    if (map_submit(pool, future, from, function) != 0) {
+        future_destroy(future);
+        return -1;
+    }
+
+    return 0;
+}
+
+future_t *map_shared(thread_pool_t *pool, future_t *from, function_t function, void (*destructor)(void *)) {
+    future_t *future = future_alloc(pool, 2, destructor);
+    if (!future) return NULL;
 
+    if (map_submit(pool, future, from, function) != 0) {
+        future_release(future);
+        return NULL;
+    }
+
+    return future;
+}
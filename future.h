@@ -2,6 +2,7 @@
 #define FUTURE_H
 
 #include "threadpool.h"
+#include <stdatomic.h>
 
 typedef struct callable {
     void *(*function)(void *, size_t, size_t *);
@@ -9,15 +10,34 @@ typedef struct callable {
     size_t argsz;
 } callable_t;
 
+struct map_data;
+
 typedef struct future {
     void *retval;
     int8_t ready;
     pthread_mutex_t lock;
     pthread_cond_t cond;
+    atomic_size_t refcount;
+    void (*destructor)(void *);
+    struct future_cache *cache;
+    struct future *next;
+    struct map_data *continuations;
 } future_t;
 
+typedef struct future_cache {
+    pthread_mutex_t lock;
+    future_t *free_futures;
+    size_t refcount;
+    int8_t closed;
+} future_cache_t;
+
+void future_init(future_t *future);
+
+void future_complete(future_t *future, void *retval);
+
 int async(thread_pool_t *pool, future_t *future, callable_t callable);
 
+// The function is queued on pool once from is ready, so a map does not occupy a worker while it waits.
 int map(thread_pool_t *pool, future_t *future, future_t *from,
         void *(*function)(void *, size_t, size_t *));
 
@@ -25,4 +45,21 @@ void *await(future_t *future);
 
 void future_destroy(future_t *future);
 
+// Shared futures are allocated from the pool's freelist and returned holding one reference for the caller. Every map
+// reading from a shared future holds its own reference until it has finished, so the caller may drop theirs as soon as
+// the future is no longer awaited. The result is passed to destructor, if any, once the last reference is gone. Shared
+// futures may outlive the pool that created them; the pool's freelist is only freed with the last of them.
+future_t *async_shared(thread_pool_t *pool, callable_t callable, void (*destructor)(void *));
+
+future_t *map_shared(thread_pool_t *pool, future_t *from, void *(*function)(void *, size_t, size_t *),
+                     void (*destructor)(void *));
+
+void future_ref(future_t *future);
+
+void future_unref(future_t *future);
+
+future_cache_t *future_cache_create();
+
+void future_cache_close(future_cache_t *cache);
+
 #endif
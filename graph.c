@@ -0,0 +1,313 @@
+#include "graph.h"
+#include "err.h"
+#include <string.h>
+
+void graph_init(graph_t *graph) {
+    memset(graph, 0, sizeof(graph_t));
+
+    if (pthread_mutex_init(&graph->lock, 0) != 0) syserr("pthread_mutex_init error\n");
+    if (pthread_cond_init(&graph->done, 0) != 0) syserr("pthread_cond_init error\n");
+}
+
+int graph_add_node(graph_t *graph, size_t *node, void *(*function)(void *, size_t, size_t *)) {
+    if (graph->built) return -1;
+
+    if (graph->num_nodes == graph->nodes_capacity) {
+        size_t capacity = graph->nodes_capacity ? 2 * graph->nodes_capacity : 16;
+        graph_node_t *nodes = realloc(graph->nodes, capacity * sizeof(graph_node_t));
+        if (!nodes) return -1;
+
+        graph->nodes = nodes;
+        graph->nodes_capacity = capacity;
+    }
+
+    *node = graph->num_nodes++;
+    memset(&graph->nodes[*node], 0, sizeof(graph_node_t));
+    graph->nodes[*node].function = function;
+
+    return 0;
+}
+
+// Until the graph is built, edges are kept as consecutive (from, to) pairs.
+int graph_add_edge(graph_t *graph, size_t from, size_t to) {
+    if (graph->built || from >= graph->num_nodes || to >= graph->num_nodes) return -1;
+
+    if (graph->num_edges == graph->edges_capacity) {
+        size_t capacity = graph->edges_capacity ? 2 * graph->edges_capacity : 16;
+        size_t *edges = realloc(graph->edges, 2 * capacity * sizeof(size_t));
+        if (!edges) return -1;
+
+        graph->edges = edges;
+        graph->edges_capacity = capacity;
+    }
+
+    graph->edges[2 * graph->num_edges] = from;
+    graph->edges[2 * graph->num_edges + 1] = to;
+    graph->num_edges++;
+    graph->nodes[from].succ_end++;
+    graph->nodes[to].num_preds++;
+
+    return 0;
+}
+
+void graph_free_layout(graph_t *graph) {
+    free(graph->succ);
+    free(graph->succ_slot);
+    free(graph->pending);
+    free(graph->args);
+    free(graph->results);
+    free(graph->ready);
+    free(graph->runner_slots);
+    graph->succ = graph->succ_slot = graph->ready = NULL;
+    graph->runner_slots = NULL;
+    graph->pending = NULL;
+    graph->args = graph->results = NULL;
+}
+
+// Orders nodes topologically into order and returns how many were reached; fewer than num_nodes means a cycle.
+size_t graph_sort(graph_t *graph, size_t *order, size_t *indegree) {
+    size_t head = 0, tail = 0;
+
+    for (size_t v = 0; v < graph->num_nodes; v++) {
+        indegree[v] = graph->nodes[v].num_preds;
+        if (!indegree[v]) order[tail++] = v;
+    }
+
+    while (head < tail) {
+        graph_node_t *node = &graph->nodes[order[head++]];
+        for (size_t e = node->succ_begin; e < node->succ_end; e++) {
+            if (--indegree[graph->succ[e]] == 0) order[tail++] = graph->succ[e];
+        }
+    }
+
+    return tail;
+}
+
+int graph_build(graph_t *graph) {
+    if (graph->built) return -1;
+
+    size_t n = graph->num_nodes, m = graph->num_edges;
+    graph->succ = malloc((m ? m : 1) * sizeof(size_t));
+    graph->succ_slot = malloc((m ? m : 1) * sizeof(size_t));
+    graph->pending = malloc((n ? n : 1) * sizeof(atomic_size_t));
+    graph->args = malloc((m ? m : 1) * sizeof(void *));
+    graph->results = malloc((n ? n : 1) * sizeof(void *));
+    graph->ready = malloc((n ? n : 1) * sizeof(size_t));
+    graph->runner_slots = malloc((n ? n : 1) * sizeof(graph_runner_t));
+    size_t *scratch = malloc(2 * (n ? n : 1) * sizeof(size_t));
+
+    if (!graph->succ || !graph->succ_slot || !graph->pending || !graph->args || !graph->results || !graph->ready ||
+        !graph->runner_slots || !scratch) {
+        graph_free_layout(graph);
+        free(scratch);
+        return -1;
+    }
+
+    // Successor and argument ranges are laid out by prefix sums over out- and in-degrees.
+    size_t succ_offset = 0, args_offset = 0;
+    for (size_t v = 0; v < n; v++) {
+        graph_node_t *node = &graph->nodes[v];
+        size_t out_degree = node->succ_end;
+
+        node->succ_begin = node->succ_end = succ_offset;
+        node->args_begin = args_offset;
+        succ_offset += out_degree;
+        args_offset += node->num_preds;
+        scratch[v] = 0;
+    }
+
+    for (size_t e = 0; e < m; e++) {
+        graph_node_t *from = &graph->nodes[graph->edges[2 * e]];
+        size_t to = graph->edges[2 * e + 1];
+
+        graph->succ[from->succ_end] = to;
+        graph->succ_slot[from->succ_end] = graph->nodes[to].args_begin + scratch[to]++;
+        from->succ_end++;
+    }
+
+    size_t *order = scratch, *indegree = scratch + n;
+    if (graph_sort(graph, order, indegree) != n) {
+        // Restore the degree counts kept in the nodes so that the graph can still be inspected or destroyed.
+        for (size_t v = 0; v < n; v++) {
+            graph->nodes[v].succ_end -= graph->nodes[v].succ_begin;
+            graph->nodes[v].succ_begin = 0;
+        }
+        graph_free_layout(graph);
+        free(scratch);
+        return -1;
+    }
+
+    // A node's priority is the number of nodes on the longest path from it to a sink.
+    for (size_t i = n; i-- > 0;) {
+        graph_node_t *node = &graph->nodes[order[i]];
+        node->priority = 0;
+        for (size_t e = node->succ_begin; e < node->succ_end; e++) {
+            size_t priority = graph->nodes[graph->succ[e]].priority;
+            if (priority > node->priority) node->priority = priority;
+        }
+        node->priority++;
+    }
+
+    free(scratch);
+    free(graph->edges);
+    graph->edges = NULL;
+    graph->edges_capacity = 0;
+    graph->built = 1;
+
+    return 0;
+}
+
+int graph_before(graph_t *graph, size_t a, size_t b) {
+    size_t pa = graph->nodes[a].priority, pb = graph->nodes[b].priority;
+    return pa > pb || (pa == pb && a < b);
+}
+
+// The ready set is a binary heap ordered by priority, so the node on the critical path is always taken first.
+void graph_ready_push(graph_t *graph, size_t v) {
+    size_t i = graph->num_ready++;
+
+    while (i > 0 && graph_before(graph, v, graph->ready[(i - 1) / 2])) {
+        graph->ready[i] = graph->ready[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    graph->ready[i] = v;
+}
+
+size_t graph_ready_pop(graph_t *graph) {
+    size_t top = graph->ready[0];
+    size_t v = graph->ready[--graph->num_ready];
+    size_t i = 0;
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= graph->num_ready) break;
+        if (child + 1 < graph->num_ready && graph_before(graph, graph->ready[child + 1], graph->ready[child])) child++;
+        if (!graph_before(graph, graph->ready[child], v)) break;
+
+        graph->ready[i] = graph->ready[child];
+        i = child;
+    }
+    if (graph->num_ready) graph->ready[i] = v;
+
+    return top;
+}
+
+void *graph_call(graph_t *graph, size_t v) {
+    graph_node_t *node = &graph->nodes[v];
+    size_t discard;
+
+    if (!node->num_preds) return node->function(graph->inputs ? graph->inputs[v] : NULL, 0, &discard);
+    if (node->num_preds == 1) return node->function(graph->args[node->args_begin], 0, &discard);
+    return node->function(&graph->args[node->args_begin], node->num_preds, &discard);
+}
+
+void graph_runner(void *arg, size_t argsz);
+
+// Queues another runner from a free slot, with the graph lock held. There are never more runners than threads in the
+// pool or nodes in the graph, so a slot is always free below that limit.
+int graph_spawn(graph_t *graph) {
+    graph_runner_t *runner = graph->free_runners;
+    if (!runner || graph->runners >= graph->max_runners) return -1;
+
+    runner->task.runnable = (runnable_t) {.function = graph_runner, .arg = runner, .argsz = sizeof(*runner)};
+    if (defer_task(graph->pool, &runner->task) != 0) return -1;
+
+    graph->free_runners = runner->next;
+    graph->runners++;
+
+    return 0;
+}
+
+void graph_runner(void *arg, __attribute__((unused)) size_t argsz) {
+    graph_runner_t *runner = (graph_runner_t *) arg;
+    graph_t *graph = runner->graph;
+
+    if (pthread_mutex_lock(&graph->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    while (graph->num_ready) {
+        size_t v = graph_ready_pop(graph);
+        // The nodes left in the heap are handed to another runner while this one is busy with v.
+        if (graph->num_ready) graph_spawn(graph);
+        if (pthread_mutex_unlock(&graph->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+        void *result = graph_call(graph, v);
+        graph->results[v] = result;
+
+        graph_node_t *node = &graph->nodes[v];
+        for (size_t e = node->succ_begin; e < node->succ_end; e++) {
+            graph->args[graph->succ_slot[e]] = result;
+            if (atomic_fetch_sub_explicit(&graph->pending[graph->succ[e]], 1, memory_order_acq_rel) != 1) continue;
+
+            if (pthread_mutex_lock(&graph->lock) != 0) syserr("pthread_mutex_lock error\n");
+            graph_ready_push(graph, graph->succ[e]);
+            if (pthread_mutex_unlock(&graph->lock) != 0) syserr("pthread_mutex_unlock error\n");
+        }
+
+        if (pthread_mutex_lock(&graph->lock) != 0) syserr("pthread_mutex_lock error\n");
+    }
+
+    // Only a running node can make others ready, so once the last runner leaves with an empty heap every node is done.
+    runner->next = graph->free_runners;
+    graph->free_runners = runner;
+    if (--graph->runners == 0) {
+        if (pthread_cond_signal(&graph->done) != 0) syserr("pthread_cond_signal error\n");
+    }
+
+    if (pthread_mutex_unlock(&graph->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+int graph_run(thread_pool_t *pool, graph_t *graph, void **inputs) {
+    if (!graph->built) return -1;
+    if (!graph->num_nodes) return 0;
+
+    if (pthread_mutex_lock(&graph->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    graph->pool = pool;
+    graph->inputs = inputs;
+    graph->num_ready = 0;
+    for (size_t v = 0; v < graph->num_nodes; v++) {
+        atomic_store_explicit(&graph->pending[v], graph->nodes[v].num_preds, memory_order_relaxed);
+        if (!graph->nodes[v].num_preds) graph_ready_push(graph, v);
+    }
+
+    // Runners are queued from slots preallocated by graph_build, so that a run does not allocate.
+    graph->free_runners = NULL;
+    for (size_t i = graph->num_nodes; i-- > 0;) {
+        graph->runner_slots[i].graph = graph;
+        graph->runner_slots[i].next = graph->free_runners;
+        graph->free_runners = &graph->runner_slots[i];
+    }
+    graph->max_runners = (pool->num_threads < graph->num_nodes) ? pool->num_threads : graph->num_nodes;
+    graph->runners = 0;
+    while (graph->runners < graph->num_ready) {
+        if (graph_spawn(graph) != 0) break;
+    }
+
+    if (!graph->runners) {
+        if (pthread_mutex_unlock(&graph->lock) != 0) syserr("pthread_mutex_unlock error\n");
+        return -1;
+    }
+
+    while (graph->runners) {
+        if (pthread_cond_wait(&graph->done, &graph->lock) != 0) syserr("pthread_cond_wait error\n");
+    }
+
+    graph->inputs = NULL;
+
+    if (pthread_mutex_unlock(&graph->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return 0;
+}
+
+void *graph_result(graph_t *graph, size_t node) {
+    return graph->results[node];
+}
+
+void graph_destroy(graph_t *graph) {
+    graph_free_layout(graph);
+    free(graph->edges);
+    free(graph->nodes);
+
+    if (pthread_cond_destroy(&graph->done) != 0) syserr("pthread_cond_destroy error\n");
+    if (pthread_mutex_destroy(&graph->lock) != 0) syserr("pthread_mutex_destroy error\n");
+}
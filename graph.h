@@ -0,0 +1,70 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "threadpool.h"
+#include <stdatomic.h>
+
+typedef struct graph_node {
+    void *(*function)(void *, size_t, size_t *);
+    size_t succ_begin;
+    size_t succ_end;
+    size_t args_begin;
+    size_t num_preds;
+    size_t priority;
+} graph_node_t;
+
+// A runner takes ready nodes until there are none left and then returns its thread to the pool.
+typedef struct graph_runner {
+    task_t task;
+    struct graph *graph;
+    struct graph_runner *next;
+} graph_runner_t;
+
+typedef struct graph {
+    graph_node_t *nodes;
+    size_t num_nodes;
+    size_t nodes_capacity;
+    size_t *edges;
+    size_t num_edges;
+    size_t edges_capacity;
+    int8_t built;
+
+    size_t *succ;
+    size_t *succ_slot;
+    atomic_size_t *pending;
+    void **args;
+    void **results;
+    size_t *ready;
+    graph_runner_t *runner_slots;
+    size_t num_ready;
+
+    thread_pool_t *pool;
+    void **inputs;
+    graph_runner_t *free_runners;
+    size_t runners;
+    size_t max_runners;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} graph_t;
+
+void graph_init(graph_t *graph);
+
+int graph_add_node(graph_t *graph, size_t *node, void *(*function)(void *, size_t, size_t *));
+
+int graph_add_edge(graph_t *graph, size_t from, size_t to);
+
+// Lays the graph out for execution and fails if it contains a cycle. No nodes or edges may be added afterwards.
+int graph_build(graph_t *graph);
+
+// Runs every node once and returns after all of them have finished. A root is called with inputs[node], a node with
+// a single predecessor with its result, as in map, and a node with several predecessors with an array of their results
+// in the order the edges were added and the array length as argsz. A graph must not be run twice concurrently. Runs do
+// not allocate memory, and a worker holds on to the run only while a node is ready, so nodes may wait for other tasks
+// on the same pool.
+int graph_run(thread_pool_t *pool, graph_t *graph, void **inputs);
+
+void *graph_result(graph_t *graph, size_t node);
+
+void graph_destroy(graph_t *graph);
+
+#endif
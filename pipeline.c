@@ -0,0 +1,166 @@
+#include "pipeline.h"
+#include "err.h"
+#include <string.h>
+
+#define PIPELINE_BATCH 32
+
+void pipeline_task_finish(pipeline_t *pipeline, size_t stage) {
+    if (pthread_mutex_lock(&pipeline->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    // The last worker of a stage to finish tells the next stage that no more items are coming.
+    if (--pipeline->running[stage] == 0) channel_close(&pipeline->channels[stage + 1]);
+    if (--pipeline->total_running == 0) {
+        if (pthread_cond_broadcast(&pipeline->done) != 0) syserr("pthread_cond_broadcast error\n");
+    }
+
+    if (pthread_mutex_unlock(&pipeline->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+void pipeline_work(void *arg, __attribute__((unused)) size_t argsz) {
+    pipeline_task_t *task = (pipeline_task_t *) arg;
+    pipeline_t *pipeline = task->pipeline;
+    pipeline_stage_t *stage = &pipeline->stages[task->stage];
+    channel_t *in = &pipeline->channels[task->stage];
+    channel_t *out = &pipeline->channels[task->stage + 1];
+    void *batch[PIPELINE_BATCH];
+    size_t received, discard;
+
+    // A worker takes at most its share of a full input channel, so that the other workers of its stage are not left
+    // waiting while it processes everything that was queued.
+    size_t max = in->capacity / stage->parallelism;
+    if (max > PIPELINE_BATCH) max = PIPELINE_BATCH;
+    if (!max) max = 1;
+
+    while ((received = channel_recv_batch(in, batch, max))) {
+        size_t produced = 0;
+        for (size_t i = 0; i < received; i++) {
+            void *result = stage->function(batch[i], 0, &discard);
+            if (result) batch[produced++] = result;
+        }
+
+        if (channel_send_batch(out, batch, produced) != produced) break;
+    }
+
+    pipeline_task_finish(pipeline, task->stage);
+}
+
+void pipeline_close_all(pipeline_t *pipeline) {
+    for (size_t i = 0; i <= pipeline->num_stages; i++) {
+        channel_close(&pipeline->channels[i]);
+    }
+}
+
+void pipeline_wait(pipeline_t *pipeline) {
+    if (pthread_mutex_lock(&pipeline->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    while (pipeline->total_running) {
+        if (pthread_cond_wait(&pipeline->done, &pipeline->lock) != 0) syserr("pthread_cond_wait error\n");
+    }
+
+    if (pthread_mutex_unlock(&pipeline->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+void pipeline_free(pipeline_t *pipeline, size_t num_channels) {
+    for (size_t i = 0; i < num_channels; i++) {
+        channel_destroy(&pipeline->channels[i]);
+    }
+
+    if (pthread_cond_destroy(&pipeline->done) != 0) syserr("pthread_cond_destroy error\n");
+    if (pthread_mutex_destroy(&pipeline->lock) != 0) syserr("pthread_mutex_destroy error\n");
+
+    free(pipeline->stages);
+    free(pipeline->channels);
+    free(pipeline->tasks);
+    free(pipeline->running);
+}
+
+int pipeline_start(pipeline_t *pipeline) {
+    int retval = 0;
+
+    if (pthread_mutex_lock(&pipeline->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    for (size_t i = 0; i < pipeline->num_stages && !retval; i++) {
+        for (size_t j = 0; j < pipeline->stages[i].parallelism; j++) {
+            if (defer(pipeline->stages[i].pool,
+                      (runnable_t) {.function = pipeline_work, .arg = &pipeline->tasks[i],
+                                    .argsz = sizeof(pipeline_task_t)}) != 0) {
+                retval = -1;
+                break;
+            }
+            pipeline->running[i]++;
+            pipeline->total_running++;
+        }
+    }
+
+    if (pthread_mutex_unlock(&pipeline->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return retval;
+}
+
+int pipeline_init(pipeline_t *pipeline, pipeline_stage_t *stages, size_t num_stages, size_t capacity) {
+    if (!num_stages) return -1;
+    for (size_t i = 0; i < num_stages; i++) {
+        if (!stages[i].parallelism) return -1;
+
+        // Workers keep their threads until the pipeline is destroyed, so a pool without a thread for each of them
+        // would leave some stage without a worker forever.
+        size_t workers = 0;
+        for (size_t j = 0; j < num_stages; j++) {
+            if (stages[j].pool == stages[i].pool) workers += stages[j].parallelism;
+        }
+        if (workers > stages[i].pool->num_threads) return -1;
+    }
+
+    pipeline->num_stages = num_stages;
+    pipeline->total_running = 0;
+    pipeline->stages = malloc(sizeof(pipeline_stage_t) * num_stages);
+    pipeline->channels = malloc(sizeof(channel_t) * (num_stages + 1));
+    pipeline->tasks = malloc(sizeof(pipeline_task_t) * num_stages);
+    pipeline->running = calloc(num_stages, sizeof(size_t));
+    if (pthread_mutex_init(&pipeline->lock, 0) != 0) syserr("pthread_mutex_init error\n");
+    if (pthread_cond_init(&pipeline->done, 0) != 0) syserr("pthread_cond_init error\n");
+
+    if (!pipeline->stages || !pipeline->channels || !pipeline->tasks || !pipeline->running) {
+        pipeline_free(pipeline, 0);
+        return -1;
+    }
+
+    memcpy(pipeline->stages, stages, sizeof(pipeline_stage_t) * num_stages);
+    for (size_t i = 0; i < num_stages; i++) {
+        pipeline->tasks[i] = (pipeline_task_t) {.pipeline = pipeline, .stage = i};
+    }
+
+    for (size_t i = 0; i <= num_stages; i++) {
+        if (channel_init(&pipeline->channels[i], capacity) != 0) {
+            pipeline_free(pipeline, i);
+            return -1;
+        }
+    }
+
+    if (pipeline_start(pipeline) != 0) {
+        pipeline_close_all(pipeline);
+        pipeline_wait(pipeline);
+        pipeline_free(pipeline, num_stages + 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+int pipeline_send(pipeline_t *pipeline, void *item) {
+    return channel_send(&pipeline->channels[0], item);
+}
+
+int pipeline_recv(pipeline_t *pipeline, void **item) {
+    return channel_recv(&pipeline->channels[pipeline->num_stages], item);
+}
+
+void pipeline_close(pipeline_t *pipeline) {
+    channel_close(&pipeline->channels[0]);
+}
+
+void pipeline_destroy(pipeline_t *pipeline) {
+    pipeline_close_all(pipeline);
+    pipeline_wait(pipeline);
+    pipeline_free(pipeline, pipeline->num_stages + 1);
+}
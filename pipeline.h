@@ -0,0 +1,48 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "channel.h"
+#include "threadpool.h"
+
+typedef struct pipeline_stage {
+    thread_pool_t *pool;
+    void *(*function)(void *, size_t, size_t *);
+    size_t parallelism;
+} pipeline_stage_t;
+
+typedef struct pipeline_task {
+    struct pipeline *pipeline;
+    size_t stage;
+} pipeline_task_t;
+
+typedef struct pipeline {
+    pipeline_stage_t *stages;
+    size_t num_stages;
+    channel_t *channels;
+    pipeline_task_t *tasks;
+    size_t *running;
+    size_t total_running;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} pipeline_t;
+
+// Every stage runs parallelism long-lived workers on its pool, which must outlive the pipeline; the call fails if a
+// pool has fewer threads than the workers of all stages placed on it. Stages are connected by channels of the given
+// capacity, so a slow stage holds back the ones before it. Each worker moves items in batches and calls function on
+// every item; NULL results are dropped. Items may leave a stage with parallelism above one in a different order than
+// they entered it.
+int pipeline_init(pipeline_t *pipeline, pipeline_stage_t *stages, size_t num_stages, size_t capacity);
+
+int pipeline_send(pipeline_t *pipeline, void *item);
+
+// Fails with -1 once the input is closed and every item has left the last stage.
+int pipeline_recv(pipeline_t *pipeline, void **item);
+
+void pipeline_close(pipeline_t *pipeline);
+
+// Stops the workers without waiting for items still in flight, which are discarded. The workers occupy their pools'
+// threads until then, so the pipeline has to be destroyed before any of its pools; thread_pool_destroy would otherwise
+// wait for them forever.
+void pipeline_destroy(pipeline_t *pipeline);
+
+#endif
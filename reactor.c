@@ -0,0 +1,252 @@
+#include "reactor.h"
+#include "err.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+
+typedef enum io_op {
+    IO_READABLE,
+    IO_WRITABLE,
+    IO_READ,
+    IO_WRITE
+} io_op_t;
+
+typedef struct io_data {
+    io_op_t op;
+    int fd;
+    char *buf;
+    size_t count;
+    size_t done;
+    future_t *future;
+    struct io_data *prev;
+    struct io_data *next;
+} io_data_t;
+
+void io_data_init(io_data_t *io_data, io_op_t op, int fd, void *buf, size_t count, future_t *future) {
+    io_data->op = op;
+    io_data->fd = fd;
+    io_data->buf = buf;
+    io_data->count = count;
+    io_data->done = 0;
+    io_data->future = future;
+}
+
+uint32_t io_events(io_op_t op) {
+    return ((op == IO_READABLE || op == IO_READ) ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+}
+
+// Pending requests are linked through their own io_data, so that a completion unlinks itself in constant time.
+void io_pending_push(reactor_t *reactor, io_data_t *io_data) {
+    if (pthread_mutex_lock(&reactor->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    io_data->prev = NULL;
+    io_data->next = reactor->pending;
+    if (reactor->pending) reactor->pending->prev = io_data;
+    reactor->pending = io_data;
+
+    if (pthread_mutex_unlock(&reactor->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+void io_pending_erase(reactor_t *reactor, io_data_t *io_data) {
+    if (pthread_mutex_lock(&reactor->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (io_data->prev) {
+        io_data->prev->next = io_data->next;
+    } else {
+        reactor->pending = io_data->next;
+    }
+    if (io_data->next) io_data->next->prev = io_data->prev;
+
+    if (pthread_mutex_unlock(&reactor->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+void io_finish(reactor_t *reactor, io_data_t *io_data, void *retval) {
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, io_data->fd, NULL);
+    close(io_data->fd);
+    io_pending_erase(reactor, io_data);
+
+    future_complete(io_data->future, retval);
+    free(io_data);
+}
+
+// Returns 1 once all bytes are transferred, 0 if the descriptor would block and -1 on error or end of file.
+int io_transfer(io_data_t *io_data) {
+    while (io_data->done < io_data->count) {
+        ssize_t n = (io_data->op == IO_READ)
+                    ? read(io_data->fd, io_data->buf + io_data->done, io_data->count - io_data->done)
+                    : write(io_data->fd, io_data->buf + io_data->done, io_data->count - io_data->done);
+
+        if (n > 0) {
+            io_data->done += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+void io_handle(reactor_t *reactor, io_data_t *io_data, uint32_t events) {
+    // The reported events are never empty, so a readiness future is told apart from a cancelled one.
+    if (io_data->op == IO_READABLE || io_data->op == IO_WRITABLE) {
+        io_finish(reactor, io_data, (void *) (uintptr_t) events);
+        return;
+    }
+
+    int status = io_transfer(io_data);
+    if (status == 0) {
+        struct epoll_event event = {.events = io_events(io_data->op), .data.ptr = io_data};
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, io_data->fd, &event) == 0) return;
+    }
+
+    io_finish(reactor, io_data, (status == 1) ? io_data->buf : NULL);
+}
+
+void reactor_work(void *data) {
+    sigset_t block_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGINT);
+    sigaddset(&block_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &block_mask, 0) != 0) syserr("pthread_sigmask error\n");
+
+    reactor_t *reactor = (reactor_t *) data;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            syserr("epoll_wait error\n");
+        }
+
+        for (int i = 0; i < n; i++) {
+            // The eventfd is the only descriptor registered without an io_data and it only ever signals shutdown.
+            if (!events[i].data.ptr) return;
+            io_handle(reactor, (io_data_t *) events[i].data.ptr, events[i].events);
+        }
+    }
+}
+
+reactor_t *reactor_create() {
+    reactor_t *reactor = malloc(sizeof(reactor_t));
+    if (!reactor) return NULL;
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        free(reactor);
+        return NULL;
+    }
+
+    reactor->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (reactor->event_fd < 0 || epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->event_fd, &event) != 0) {
+        if (reactor->event_fd >= 0) close(reactor->event_fd);
+        close(reactor->epoll_fd);
+        free(reactor);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&reactor->lock, 0) != 0) syserr("pthread_mutex_init error\n");
+    reactor->pending = NULL;
+
+    if (pthread_create(&reactor->thread, 0, (void *) reactor_work, reactor) != 0) syserr("pthread_create error\n");
+
+    return reactor;
+}
+
+void reactor_destroy(reactor_t *reactor) {
+    uint64_t stop = 1;
+    if (write(reactor->event_fd, &stop, sizeof(stop)) != sizeof(stop)) syserr("eventfd write error\n");
+    if (pthread_join(reactor->thread, 0) != 0) syserr("pthread_join error\n");
+
+    // The reactor is detached from its pool by now, so nothing else can reach the pending requests.
+    io_data_t *io_data;
+    while ((io_data = reactor->pending)) {
+        reactor->pending = io_data->next;
+        close(io_data->fd);
+        future_complete(io_data->future, NULL);
+        free(io_data);
+    }
+
+    close(reactor->event_fd);
+    close(reactor->epoll_fd);
+    if (pthread_mutex_destroy(&reactor->lock) != 0) syserr("pthread_mutex_destroy error\n");
+    free(reactor);
+}
+
+// Registers the request while holding the pool lock, so that thread_pool_destroy either drains it with the reactor or
+// makes it fail; the reactor is started on first use.
+int io_register(thread_pool_t *pool, io_data_t *io_data) {
+    int retval = -1;
+
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (!pool->terminate && !pool->closing && !pool->reactor) pool->reactor = reactor_create();
+    reactor_t *reactor = (pool->terminate || pool->closing) ? NULL : pool->reactor;
+
+    if (reactor) {
+        io_pending_push(reactor, io_data);
+        struct epoll_event event = {.events = io_events(io_data->op), .data.ptr = io_data};
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, io_data->fd, &event) == 0) {
+            retval = 0;
+        } else {
+            io_pending_erase(reactor, io_data);
+        }
+    }
+
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return retval;
+}
+
+int io_submit(thread_pool_t *pool, future_t *future, int fd, io_op_t op, void *buf, size_t count) {
+    if ((op == IO_READ || op == IO_WRITE) && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) return -1;
+
+    io_data_t *io_data = malloc(sizeof(io_data_t));
+    if (!io_data) return -1;
+
+    // Each request watches its own duplicate so that a read and a write may be pending on one descriptor at once.
+    int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dup_fd < 0) {
+        free(io_data);
+        return -1;
+    }
+
+    future_init(future);
+    io_data_init(io_data, op, dup_fd, buf, count, future);
+
+    if (io_register(pool, io_data) != 0) {
+        future_destroy(future);
+        close(dup_fd);
+        free(io_data);
+        return -1;
+    }
+
+    return 0;
+}
+
+int io_readable(thread_pool_t *pool, future_t *future, int fd) {
+    return io_submit(pool, future, fd, IO_READABLE, NULL, 0);
+}
+
+int io_writable(thread_pool_t *pool, future_t *future, int fd) {
+    return io_submit(pool, future, fd, IO_WRITABLE, NULL, 0);
+}
+
+int io_read(thread_pool_t *pool, future_t *future, int fd, void *buf, size_t count) {
+    return io_submit(pool, future, fd, IO_READ, buf, count);
+}
+
+int io_write(thread_pool_t *pool, future_t *future, int fd, const void *buf, size_t count) {
+    return io_submit(pool, future, fd, IO_WRITE, (void *) buf, count);
+}
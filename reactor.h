@@ -0,0 +1,30 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "future.h"
+
+struct io_data;
+
+typedef struct reactor {
+    int epoll_fd;
+    int event_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    struct io_data *pending;
+} reactor_t;
+
+// Readiness futures resolve to the epoll event mask that was reported, cast to a pointer, which may include EPOLLHUP or
+// EPOLLERR. Transfer futures resolve to buf once all count bytes have been moved and to NULL on error or end of file;
+// io_read and io_write switch fd to non-blocking mode. A request still pending when its pool is destroyed resolves to
+// NULL.
+int io_readable(thread_pool_t *pool, future_t *future, int fd);
+
+int io_writable(thread_pool_t *pool, future_t *future, int fd);
+
+int io_read(thread_pool_t *pool, future_t *future, int fd, void *buf, size_t count);
+
+int io_write(thread_pool_t *pool, future_t *future, int fd, const void *buf, size_t count);
+
+void reactor_destroy(reactor_t *reactor);
+
+#endif
@@ -15,12 +15,6 @@ void *multiply(void *arg, __attribute__((unused)) size_t size, __attribute__((un
     return iter;
 }
 
-void destroy_futures(future_t *future, u_int64_t last_initialised) {
-    for (u_int64_t i = 0; i < last_initialised; i++) {
-        future_destroy(&future[i]);
-    }
-}
-
 int main() {
     thread_pool_t pool;
     if (thread_pool_init(&pool, POOL_SIZE) != 0) {
@@ -32,27 +26,28 @@ int main() {
     iter_t iter = {.k = 1, .retval = 1};
 
     scanf("%ld", &n);
-    future_t futures[n ? n : 1];
-
 
-    if (async(&pool, &futures[k],
-              (callable_t) {.function = multiply, .arg = &iter, .argsz = sizeof(iter_t)}) != 0) {
+    future_t *future = async_shared(&pool, (callable_t) {.function = multiply, .arg = &iter, .argsz = sizeof(iter_t)},
+                                    NULL);
+    if (!future) {
         perror("async error");
         thread_pool_destroy(&pool);
-        destroy_futures(futures, k);
         return -1;
     };
 
     while (++k < n) {
-        if (map(&pool, &futures[k], &futures[k - 1], multiply) != 0) {
+        future_t *next = map_shared(&pool, future, multiply, NULL);
+        future_unref(future);
+        if (!next) {
             perror("map error");
             thread_pool_destroy(&pool);
-            destroy_futures(futures, k);
             return -1;
         };
+        future = next;
     }
 
-    await(&futures[k - 1]);
+    await(future);
+    future_unref(future);
     printf("%lu\n", iter.retval);
 
     thread_pool_destroy(&pool);
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "future.h"
 #include "minunit.h"
@@ -32,8 +33,39 @@ static char *test_await_simple() {
   return 0;
 }
 
+static void *slow_squared(void *arg, size_t argsz, size_t *retsz) {
+  usleep(20000);
+  return squared(arg, argsz, retsz);
+}
+
+// Destroying the map's pool while its source is still running must wait
+// until the map has been queued and run.
+static char *test_map_pool_destroyed_first() {
+  thread_pool_t first, second;
+  thread_pool_init(&first, 1);
+  thread_pool_init(&second, 1);
+
+  int n = 4;
+  future_t source, mapped;
+  async(&first, &source,
+        (callable_t){.function = slow_squared, .arg = &n, .argsz = sizeof(int)});
+  map(&second, &mapped, &source, squared);
+  thread_pool_destroy(&second);
+
+  int *m = await(&mapped);
+  mu_assert("expected 256", *m == 256);
+  free(m);
+  free(await(&source));
+
+  future_destroy(&mapped);
+  future_destroy(&source);
+  thread_pool_destroy(&first);
+  return 0;
+}
+
 static char *all_tests() {
   mu_run_test(test_await_simple);
+  mu_run_test(test_map_pool_destroyed_first);
   return 0;
 }
 
@@ -0,0 +1,121 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "channel.h"
+#include "minunit.h"
+
+int tests_run = 0;
+
+#define NTHREADS 4
+#define NITEMS 10000
+
+static char *test_fifo() {
+  channel_t channel;
+  channel_init(&channel, 4);
+
+  for (uintptr_t i = 1; i <= 4; ++i)
+    mu_assert("expected send to succeed",
+              channel_try_send(&channel, (void *)i) == 0);
+  mu_assert("expected full channel to refuse",
+            channel_try_send(&channel, (void *)5) == 1);
+
+  void *item;
+  for (uintptr_t i = 1; i <= 4; ++i) {
+    channel_recv(&channel, &item);
+    mu_assert("expected items in order", (uintptr_t)item == i);
+  }
+  mu_assert("expected empty channel to refuse",
+            channel_try_recv(&channel, &item) == 1);
+  mu_assert("expected an empty batch without blocking",
+            channel_recv_batch(&channel, &item, 0) == 0);
+
+  channel_destroy(&channel);
+  return 0;
+}
+
+static char *test_close() {
+  channel_t channel;
+  channel_init(&channel, 4);
+
+  channel_send(&channel, (void *)1);
+  channel_close(&channel);
+
+  void *item;
+  mu_assert("expected send after close to fail",
+            channel_send(&channel, (void *)2) == -1);
+  mu_assert("expected queued item to be delivered",
+            channel_recv(&channel, &item) == 0 && (uintptr_t)item == 1);
+  mu_assert("expected drained channel to fail",
+            channel_recv(&channel, &item) == -1);
+  mu_assert("expected drained channel to fail without blocking",
+            channel_try_recv(&channel, &item) == -1);
+
+  channel_destroy(&channel);
+  return 0;
+}
+
+static void *producer(void *arg) {
+  channel_t *channel = arg;
+  for (uintptr_t i = 1; i <= NITEMS; ++i)
+    channel_send(channel, (void *)i);
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  channel_t *channel = arg;
+  void *items[8];
+  uintptr_t sum = 0;
+  size_t received;
+  while ((received = channel_recv_batch(channel, items, 8)))
+    for (size_t i = 0; i < received; ++i)
+      sum += (uintptr_t)items[i];
+  return (void *)sum;
+}
+
+static char *test_mpmc() {
+  channel_t channel;
+  channel_init(&channel, 16);
+
+  pthread_t producers[NTHREADS], consumers[NTHREADS];
+  for (int i = 0; i < NTHREADS; ++i) {
+    pthread_create(&producers[i], 0, producer, &channel);
+    pthread_create(&consumers[i], 0, consumer, &channel);
+  }
+  for (int i = 0; i < NTHREADS; ++i)
+    pthread_join(producers[i], 0);
+  channel_close(&channel);
+
+  uintptr_t sum = 0;
+  for (int i = 0; i < NTHREADS; ++i) {
+    void *partial;
+    pthread_join(consumers[i], &partial);
+    sum += (uintptr_t)partial;
+  }
+
+  mu_assert("expected every item to be received exactly once",
+            sum == (uintptr_t)NTHREADS * NITEMS * (NITEMS + 1) / 2);
+
+  channel_destroy(&channel);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_fifo);
+  mu_run_test(test_close);
+  mu_run_test(test_mpmc);
+  return 0;
+}
+
+int main() {
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
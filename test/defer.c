@@ -50,8 +50,37 @@ static char *ping_pong() {
   return 0;
 }
 
+#define NTASKS 16
+
+static void count_task(void *arg, size_t argsz __attribute__((unused))) {
+  sem_post(arg);
+}
+
+static char *preallocated_tasks() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+
+  sem_t done;
+  sem_init(&done, 0, 0);
+
+  task_t tasks[NTASKS];
+  for (int i = 0; i < NTASKS; ++i) {
+    tasks[i].runnable = (runnable_t){.function = count_task, .arg = &done,
+                                     .argsz = sizeof(sem_t)};
+    mu_assert("expected defer_task to succeed",
+              defer_task(&pool, &tasks[i]) == 0);
+  }
+  for (int i = 0; i < NTASKS; ++i)
+    sem_wait(&done);
+
+  sem_destroy(&done);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
 static char *all_tests() {
   mu_run_test(ping_pong);
+  mu_run_test(preallocated_tasks);
   return 0;
 }
 
@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "future.h"
+#include "graph.h"
+#include "minunit.h"
+
+int tests_run = 0;
+
+#define NRUNS 1000
+
+static void *identity(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  return arg;
+}
+
+static void *twice(void *arg, size_t argsz __attribute__((unused)),
+                   size_t *retsz __attribute__((unused))) {
+  return (void *)(2 * (uintptr_t)arg);
+}
+
+static void *plus_one(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  return (void *)((uintptr_t)arg + 1);
+}
+
+// Weights the inputs by position so that argument order is observable.
+static void *weighted_sum(void *arg, size_t argsz,
+                          size_t *retsz __attribute__((unused))) {
+  void **args = arg;
+  uintptr_t sum = 0;
+  for (size_t i = 0; i < argsz; ++i)
+    sum = 10 * sum + (uintptr_t)args[i];
+  return (void *)sum;
+}
+
+static char *test_diamond() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 3);
+
+  graph_t graph;
+  graph_init(&graph);
+
+  size_t root, left, right, join;
+  graph_add_node(&graph, &root, identity);
+  graph_add_node(&graph, &left, twice);
+  graph_add_node(&graph, &right, plus_one);
+  graph_add_node(&graph, &join, weighted_sum);
+  graph_add_edge(&graph, root, left);
+  graph_add_edge(&graph, root, right);
+  graph_add_edge(&graph, left, join);
+  graph_add_edge(&graph, right, join);
+  mu_assert("expected build to succeed", graph_build(&graph) == 0);
+  mu_assert("expected no nodes after build",
+            graph_add_node(&graph, &root, identity) != 0);
+
+  for (uintptr_t i = 0; i < NRUNS; ++i) {
+    void *inputs[4] = {(void *)(i % 4)};
+    mu_assert("expected run to succeed", graph_run(&pool, &graph, inputs) == 0);
+    uintptr_t expected = 10 * (2 * (i % 4)) + (i % 4) + 1;
+    mu_assert("unexpected join result",
+              (uintptr_t)graph_result(&graph, join) == expected);
+  }
+
+  graph_destroy(&graph);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_cycle() {
+  graph_t graph;
+  graph_init(&graph);
+
+  size_t a, b, c;
+  graph_add_node(&graph, &a, identity);
+  graph_add_node(&graph, &b, identity);
+  graph_add_node(&graph, &c, identity);
+  graph_add_edge(&graph, a, b);
+  graph_add_edge(&graph, b, c);
+  graph_add_edge(&graph, c, b);
+  mu_assert("expected cycle to be rejected", graph_build(&graph) != 0);
+
+  graph_destroy(&graph);
+  return 0;
+}
+
+static size_t order[4];
+static size_t executed;
+
+static void *record(void *arg, size_t argsz __attribute__((unused)),
+                    size_t *retsz __attribute__((unused))) {
+  order[executed++] = (uintptr_t)arg;
+  return (void *)((uintptr_t)arg + 1);
+}
+
+static char *test_critical_path_first() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  graph_t graph;
+  graph_init(&graph);
+
+  // The shallow root is added first, but the deep chain is the critical path.
+  // Each node records its input and passes on its successor's label.
+  size_t shallow, deep, mid, tail;
+  graph_add_node(&graph, &shallow, record);
+  graph_add_node(&graph, &deep, record);
+  graph_add_node(&graph, &mid, record);
+  graph_add_node(&graph, &tail, record);
+  graph_add_edge(&graph, deep, mid);
+  graph_add_edge(&graph, mid, tail);
+  graph_build(&graph);
+
+  executed = 0;
+  void *inputs[4] = {(void *)0, (void *)1};
+  graph_run(&pool, &graph, inputs);
+
+  mu_assert("expected every node to run", executed == 4);
+  mu_assert("expected the deep root first", order[0] == 1);
+  mu_assert("expected the chain to go before the shallow root", order[1] == 2);
+  mu_assert("expected the shallow root before the tail", order[2] == 0);
+
+  graph_destroy(&graph);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static thread_pool_t *shared_pool;
+
+// Waits for a task on the pool the graph runs on.
+static void *await_plus_one(void *arg, size_t argsz __attribute__((unused)),
+                            size_t *retsz __attribute__((unused))) {
+  future_t future;
+  async(shared_pool, &future,
+        (callable_t){.function = plus_one, .arg = arg, .argsz = 0});
+  void *result = await(&future);
+  future_destroy(&future);
+  return result;
+}
+
+// Idle runners must give their threads back to the pool, or the chain's
+// tasks never get to run.
+static char *test_nodes_await_same_pool() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+  shared_pool = &pool;
+
+  graph_t graph;
+  graph_init(&graph);
+
+  size_t a, b, c;
+  graph_add_node(&graph, &a, await_plus_one);
+  graph_add_node(&graph, &b, await_plus_one);
+  graph_add_node(&graph, &c, await_plus_one);
+  graph_add_edge(&graph, a, b);
+  graph_add_edge(&graph, b, c);
+  graph_build(&graph);
+
+  for (uintptr_t i = 0; i < 100; ++i) {
+    void *inputs[3] = {(void *)i};
+    mu_assert("expected run to succeed", graph_run(&pool, &graph, inputs) == 0);
+    mu_assert("expected the chain to add three",
+              (uintptr_t)graph_result(&graph, c) == i + 3);
+  }
+
+  graph_destroy(&graph);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_diamond);
+  mu_run_test(test_cycle);
+  mu_run_test(test_critical_path_first);
+  mu_run_test(test_nodes_await_same_pool);
+  return 0;
+}
+
+int main() {
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
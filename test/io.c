@@ -0,0 +1,257 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "minunit.h"
+#include "reactor.h"
+
+int tests_run = 0;
+
+#define BIGSZ (1 << 18)
+
+static void *length(void *arg, size_t argsz __attribute__((unused)),
+                    size_t *retsz __attribute__((unused))) {
+  return (void *)(uintptr_t)strlen(arg);
+}
+
+static void write_later(void *arg, size_t argsz __attribute__((unused))) {
+  int fd = *(int *)arg;
+  usleep(10000);
+  write(fd, "hello", 5);
+}
+
+static char *test_readable() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+
+  int fds[2];
+  pipe(fds);
+
+  future_t future;
+  io_readable(&pool, &future, fds[0]);
+  defer(&pool, (runnable_t){.function = write_later, .arg = &fds[1],
+                            .argsz = sizeof(int)});
+  uintptr_t events = (uintptr_t)await(&future);
+  mu_assert("expected EPOLLIN to be reported", events & EPOLLIN);
+
+  char buf[5];
+  mu_assert("expected pipe to be readable", read(fds[0], buf, 5) == 5);
+
+  future_destroy(&future);
+  close(fds[0]);
+  close(fds[1]);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static void write_rest(void *arg, size_t argsz __attribute__((unused))) {
+  int fd = *(int *)arg;
+  usleep(10000);
+  write(fd, "lo", 2);
+}
+
+// The only worker must stay free while the map waits for the read, since the
+// rest of the data is written by a task on the same pool.
+static char *test_read_map() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  int fds[2];
+  pipe(fds);
+
+  char buf[6] = {0};
+  future_t read_future, len_future;
+  io_read(&pool, &read_future, fds[0], buf, 5);
+  map(&pool, &len_future, &read_future, length);
+
+  write(fds[1], "hel", 3);
+  usleep(10000);
+  defer(&pool, (runnable_t){.function = write_rest, .arg = &fds[1],
+                            .argsz = sizeof(int)});
+
+  mu_assert("expected read to resolve to its buffer", await(&read_future) == buf);
+  mu_assert("expected mapped length 5", (uintptr_t)await(&len_future) == 5);
+  mu_assert("expected hello", strcmp(buf, "hello") == 0);
+
+  future_destroy(&len_future);
+  future_destroy(&read_future);
+  close(fds[0]);
+  close(fds[1]);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_socketpair_duplex() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  int sv[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+
+  char *out = malloc(BIGSZ);
+  char *in = malloc(BIGSZ);
+  for (size_t i = 0; i < BIGSZ; ++i)
+    out[i] = (char)i;
+
+  future_t write_future, read_future;
+  io_write(&pool, &write_future, sv[0], out, BIGSZ);
+  io_read(&pool, &read_future, sv[1], in, BIGSZ);
+
+  mu_assert("expected write to complete", await(&write_future) == out);
+  mu_assert("expected read to complete", await(&read_future) == in);
+  mu_assert("expected identical payload", memcmp(in, out, BIGSZ) == 0);
+
+  future_destroy(&read_future);
+  future_destroy(&write_future);
+  free(in);
+  free(out);
+  close(sv[0]);
+  close(sv[1]);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_read_eof() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  int fds[2];
+  pipe(fds);
+
+  char buf[8];
+  future_t future;
+  io_read(&pool, &future, fds[0], buf, sizeof(buf));
+  write(fds[1], "abc", 3);
+  close(fds[1]);
+
+  mu_assert("expected NULL on premature end of file", await(&future) == NULL);
+
+  future_destroy(&future);
+  close(fds[0]);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_destroy_pending() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  int fds[2];
+  pipe(fds);
+
+  future_t ready, future;
+  io_writable(&pool, &ready, fds[1]);
+  void *ready_result = await(&ready);
+  io_readable(&pool, &future, fds[0]);
+  thread_pool_destroy(&pool);
+
+  void *cancelled_result = await(&future);
+  mu_assert("expected pending request to be resolved to NULL",
+            cancelled_result == NULL);
+  mu_assert("expected success and cancellation to differ",
+            ready_result != cancelled_result);
+
+  future_destroy(&ready);
+  future_destroy(&future);
+  close(fds[0]);
+  close(fds[1]);
+  return 0;
+}
+
+typedef struct late_request {
+  thread_pool_t *pool;
+  int fd;
+  int result;
+  future_t future;
+} late_request_t;
+
+static void request_late(void *arg, size_t argsz __attribute__((unused))) {
+  late_request_t *request = arg;
+  usleep(20000);
+  request->result = io_readable(request->pool, &request->future, request->fd);
+}
+
+// A task still draining during thread_pool_destroy must not start a reactor.
+static char *test_request_during_destroy() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  int fds[2];
+  pipe(fds);
+
+  late_request_t request = {.pool = &pool, .fd = fds[0], .result = 0};
+  defer(&pool, (runnable_t){.function = request_late, .arg = &request,
+                            .argsz = sizeof(request)});
+  thread_pool_destroy(&pool);
+
+  mu_assert("expected request during destroy to fail", request.result == -1);
+
+  close(fds[0]);
+  close(fds[1]);
+  return 0;
+}
+
+static atomic_int destroyed;
+
+static void destroy_result(void *ptr __attribute__((unused))) {
+  atomic_fetch_add(&destroyed, 1);
+}
+
+// A pool with a reactor must still tear down its freelist of shared futures.
+static char *test_shared_with_reactor() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+
+  int fds[2];
+  pipe(fds);
+
+  future_t writable;
+  io_writable(&pool, &writable, fds[1]);
+  await(&writable);
+  future_destroy(&writable);
+
+  atomic_store(&destroyed, 0);
+  for (int i = 0; i < 10; ++i) {
+    future_t *future = async_shared(
+        &pool, (callable_t){.function = length, .arg = "abc", .argsz = 4},
+        destroy_result);
+    mu_assert("expected shared length 3", (uintptr_t)await(future) == 3);
+    future_unref(future);
+  }
+
+  thread_pool_destroy(&pool);
+  mu_assert("expected every shared result to be destroyed",
+            atomic_load(&destroyed) == 10);
+
+  close(fds[0]);
+  close(fds[1]);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_readable);
+  mu_run_test(test_read_map);
+  mu_run_test(test_socketpair_duplex);
+  mu_run_test(test_read_eof);
+  mu_run_test(test_destroy_pending);
+  mu_run_test(test_shared_with_reactor);
+  mu_run_test(test_request_during_destroy);
+  return 0;
+}
+
+int main() {
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
@@ -0,0 +1,187 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "minunit.h"
+#include "pipeline.h"
+
+int tests_run = 0;
+
+#define NITEMS 10000
+
+static void *square(void *arg, size_t argsz __attribute__((unused)),
+                    size_t *retsz __attribute__((unused))) {
+  uintptr_t n = (uintptr_t)arg;
+  return (void *)(n * n);
+}
+
+static void *drop_odd(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  return ((uintptr_t)arg % 2) ? NULL : arg;
+}
+
+static void *feed(void *arg) {
+  pipeline_t *pipeline = arg;
+  for (uintptr_t i = 1; i <= NITEMS; ++i)
+    pipeline_send(pipeline, (void *)i);
+  pipeline_close(pipeline);
+  return NULL;
+}
+
+static char *test_two_pools() {
+  thread_pool_t first, second;
+  thread_pool_init(&first, 3);
+  thread_pool_init(&second, 1);
+
+  pipeline_stage_t stages[] = {
+      {.pool = &first, .function = square, .parallelism = 3},
+      {.pool = &second, .function = drop_odd, .parallelism = 1},
+  };
+  pipeline_t pipeline;
+  mu_assert("expected pipeline to start",
+            pipeline_init(&pipeline, stages, 2, 8) == 0);
+
+  pthread_t feeder;
+  pthread_create(&feeder, 0, feed, &pipeline);
+
+  uintptr_t sum = 0, expected = 0;
+  size_t count = 0;
+  void *item;
+  while (pipeline_recv(&pipeline, &item) == 0) {
+    sum += (uintptr_t)item;
+    count++;
+  }
+  for (uintptr_t i = 2; i <= NITEMS; i += 2)
+    expected += i * i;
+
+  pthread_join(feeder, 0);
+  mu_assert("expected odd squares to be dropped", count == NITEMS / 2);
+  mu_assert("unexpected sum of even squares", sum == expected);
+
+  pipeline_destroy(&pipeline);
+  thread_pool_destroy(&second);
+  thread_pool_destroy(&first);
+  return 0;
+}
+
+#define NWORKERS 4
+
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t workers[NWORKERS];
+static size_t num_workers;
+
+static void *slow_record(void *arg, size_t argsz __attribute__((unused)),
+                         size_t *retsz __attribute__((unused))) {
+  pthread_mutex_lock(&workers_lock);
+  size_t i = 0;
+  while (i < num_workers && !pthread_equal(workers[i], pthread_self()))
+    i++;
+  if (i == num_workers && num_workers < NWORKERS)
+    workers[num_workers++] = pthread_self();
+  pthread_mutex_unlock(&workers_lock);
+
+  usleep(20000);
+  return arg;
+}
+
+// A full channel holds one batch for every worker of the stage, so that none
+// of them takes all queued items while the others wait.
+static char *test_workers_share_batches() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, NWORKERS);
+  num_workers = 0;
+
+  pipeline_stage_t stage = {.pool = &pool, .function = slow_record,
+                            .parallelism = NWORKERS};
+  pipeline_t pipeline;
+  pipeline_init(&pipeline, &stage, 1, 2 * NWORKERS);
+
+  for (uintptr_t i = 1; i <= 2 * NWORKERS; ++i)
+    pipeline_send(&pipeline, (void *)i);
+  pipeline_close(&pipeline);
+
+  size_t count = 0;
+  void *item;
+  while (pipeline_recv(&pipeline, &item) == 0)
+    count++;
+
+  mu_assert("expected every item to leave the stage", count == 2 * NWORKERS);
+  mu_assert("expected every worker to take part", num_workers == NWORKERS);
+
+  pipeline_destroy(&pipeline);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_destroy_undrained() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+
+  pipeline_stage_t stages[] = {
+      {.pool = &pool, .function = square, .parallelism = 1},
+      {.pool = &pool, .function = square, .parallelism = 1},
+  };
+  pipeline_t pipeline;
+  pipeline_init(&pipeline, stages, 2, 2);
+
+  // Fill every channel so that both workers block on a full output.
+  for (uintptr_t i = 1; i <= 6; ++i)
+    pipeline_send(&pipeline, (void *)i);
+
+  pipeline_destroy(&pipeline);
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_zero_parallelism() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  pipeline_stage_t stage = {.pool = &pool, .function = square,
+                            .parallelism = 0};
+  pipeline_t pipeline;
+  mu_assert("expected a stage without workers to be rejected",
+            pipeline_init(&pipeline, &stage, 1, 4) != 0);
+
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *test_too_few_threads() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+
+  pipeline_stage_t stages[] = {
+      {.pool = &pool, .function = square, .parallelism = 1},
+      {.pool = &pool, .function = square, .parallelism = 1},
+  };
+  pipeline_t pipeline;
+  mu_assert("expected stages sharing a 1-thread pool to be rejected",
+            pipeline_init(&pipeline, stages, 2, 4) != 0);
+
+  thread_pool_destroy(&pool);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_two_pools);
+  mu_run_test(test_workers_share_batches);
+  mu_run_test(test_destroy_undrained);
+  mu_run_test(test_zero_parallelism);
+  mu_run_test(test_too_few_threads);
+  return 0;
+}
+
+int main() {
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
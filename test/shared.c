@@ -0,0 +1,181 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "future.h"
+#include "minunit.h"
+
+int tests_run = 0;
+
+#define NCONSUMERS 64
+#define NCYCLES 20000
+
+static atomic_int destroyed;
+
+static void destroy_int(void *ptr) {
+  atomic_fetch_add(&destroyed, 1);
+  free(ptr);
+}
+
+static void *make_int(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  int *ret = malloc(sizeof(int));
+  *ret = *(int *)arg;
+  return ret;
+}
+
+static void *slow_int(void *arg, size_t argsz, size_t *retsz) {
+  usleep(10000);
+  return make_int(arg, argsz, retsz);
+}
+
+static void *plus_one(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  int *ret = malloc(sizeof(int));
+  *ret = *(int *)arg + 1;
+  return ret;
+}
+
+static char *test_fan_out() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 4);
+  atomic_store(&destroyed, 0);
+
+  int n = 41;
+  future_t *root = async_shared(
+      &pool, (callable_t){.function = slow_int, .arg = &n, .argsz = sizeof(int)},
+      destroy_int);
+
+  future_t *consumers[NCONSUMERS];
+  for (int i = 0; i < NCONSUMERS; ++i)
+    consumers[i] = map_shared(&pool, root, plus_one, destroy_int);
+  future_unref(root);
+
+  for (int i = 0; i < NCONSUMERS; ++i) {
+    mu_assert("expected 42", *(int *)await(consumers[i]) == 42);
+    future_unref(consumers[i]);
+  }
+
+  thread_pool_destroy(&pool);
+  mu_assert("expected every result to be destroyed once",
+            atomic_load(&destroyed) == NCONSUMERS + 1);
+  return 0;
+}
+
+static char *test_unref_before_completion() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 1);
+  atomic_store(&destroyed, 0);
+
+  int n = 7;
+  future_t *future = async_shared(
+      &pool, (callable_t){.function = slow_int, .arg = &n, .argsz = sizeof(int)},
+      destroy_int);
+  future_unref(future);
+
+  thread_pool_destroy(&pool);
+  mu_assert("expected result to be destroyed after completion",
+            atomic_load(&destroyed) == 1);
+  return 0;
+}
+
+static char *test_plain_from_shared() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+  atomic_store(&destroyed, 0);
+
+  int n = 1;
+  future_t *root = async_shared(
+      &pool, (callable_t){.function = make_int, .arg = &n, .argsz = sizeof(int)},
+      destroy_int);
+
+  future_t mapped;
+  map(&pool, &mapped, root, plus_one);
+  future_unref(root);
+
+  int *m = await(&mapped);
+  mu_assert("expected 2", *m == 2);
+  free(m);
+  future_destroy(&mapped);
+
+  thread_pool_destroy(&pool);
+  mu_assert("expected shared source to be destroyed",
+            atomic_load(&destroyed) == 1);
+  return 0;
+}
+
+static void *slow_plus_one(void *arg, size_t argsz, size_t *retsz) {
+  usleep(20000);
+  return plus_one(arg, argsz, retsz);
+}
+
+// The map on the second pool drops the last reference to the root only
+// after the root's pool has been destroyed.
+static char *test_outlive_pool() {
+  thread_pool_t first, second;
+  thread_pool_init(&first, 1);
+  thread_pool_init(&second, 1);
+  atomic_store(&destroyed, 0);
+
+  int n = 5;
+  future_t *root = async_shared(
+      &first, (callable_t){.function = make_int, .arg = &n, .argsz = sizeof(int)},
+      destroy_int);
+  await(root);
+  future_t *mapped = map_shared(&second, root, slow_plus_one, destroy_int);
+  future_unref(root);
+
+  thread_pool_destroy(&first);
+
+  mu_assert("expected 6", *(int *)await(mapped) == 6);
+  future_unref(mapped);
+
+  thread_pool_destroy(&second);
+  mu_assert("expected both results to be destroyed",
+            atomic_load(&destroyed) == 2);
+  return 0;
+}
+
+static char *test_freelist_cycles() {
+  thread_pool_t pool;
+  thread_pool_init(&pool, 2);
+  atomic_store(&destroyed, 0);
+
+  int n = 3;
+  for (int i = 0; i < NCYCLES; ++i) {
+    future_t *future = async_shared(
+        &pool,
+        (callable_t){.function = make_int, .arg = &n, .argsz = sizeof(int)},
+        destroy_int);
+    mu_assert("expected allocation to succeed", future != NULL);
+    future_unref(future);
+  }
+
+  thread_pool_destroy(&pool);
+  mu_assert("expected every cycle to be reclaimed",
+            atomic_load(&destroyed) == NCYCLES);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_fan_out);
+  mu_run_test(test_unref_before_completion);
+  mu_run_test(test_plain_from_shared);
+  mu_run_test(test_outlive_pool);
+  mu_run_test(test_freelist_cycles);
+  return 0;
+}
+
+int main() {
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
@@ -0,0 +1,260 @@
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "future.h"
+#include "minunit.h"
+
+int tests_run = 0;
+
+// Usage: test_stress [seed] [producers] [ops per producer] [p99 budget us]
+// [stall ms]
+static unsigned seed = 1;
+static size_t nproducers = 4;
+static size_t nops = 20000;
+static uint64_t p99_budget_us = 100000;
+static uint64_t stall_ms = 2000;
+
+#define POOL_SIZE 4
+#define WINDOW 64
+#define MAX_SPIN 2000
+
+enum op_kind { OP_DEFER, OP_ASYNC, OP_MAP };
+
+typedef struct op {
+  enum op_kind kind;
+  unsigned spin;
+  uint64_t submitted_ns;
+  uint64_t latency_ns;
+  sem_t *window;
+} op_t;
+
+typedef struct producer {
+  unsigned seed;
+  op_t *ops;
+  sem_t window;
+  thread_pool_t *pools;
+} producer_t;
+
+static atomic_size_t completed;
+static atomic_size_t failed;
+static atomic_int finished;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void spin(unsigned iterations) {
+  for (volatile unsigned i = 0; i < iterations; ++i)
+    ;
+}
+
+static void op_start(op_t *op) {
+  op->latency_ns = now_ns() - op->submitted_ns;
+  spin(op->spin);
+}
+
+static void op_finish(op_t *op) {
+  atomic_fetch_add(&completed, 1);
+  sem_post(op->window);
+}
+
+// A submission that failed never runs, so its window slot is given back here.
+static void op_failed(op_t *op) {
+  atomic_fetch_add(&failed, 1);
+  sem_post(op->window);
+}
+
+static void deferred_op(void *arg, size_t argsz __attribute__((unused))) {
+  op_start(arg);
+  op_finish(arg);
+}
+
+static void *async_task(void *arg, size_t argsz __attribute__((unused)),
+                        size_t *retsz __attribute__((unused))) {
+  op_t *op = arg;
+  op_start(op);
+  if (op->kind == OP_ASYNC)
+    op_finish(op);
+  return op;
+}
+
+static void *map_task(void *arg, size_t argsz __attribute__((unused)),
+                      size_t *retsz __attribute__((unused))) {
+  op_t *op = arg;
+  spin(op->spin);
+  op_finish(op);
+  return op;
+}
+
+static void *produce(void *arg) {
+  producer_t *producer = arg;
+
+  for (size_t i = 0; i < nops; ++i) {
+    op_t *op = &producer->ops[i];
+    thread_pool_t *pool = &producer->pools[rand_r(&producer->seed) % 2];
+    op->kind = rand_r(&producer->seed) % 3;
+    op->spin = rand_r(&producer->seed) % MAX_SPIN;
+    op->window = &producer->window;
+
+    sem_wait(&producer->window);
+    op->submitted_ns = now_ns();
+
+    if (op->kind == OP_DEFER) {
+      if (defer(pool, (runnable_t){.function = deferred_op, .arg = op,
+                                   .argsz = sizeof(op_t)}) != 0)
+        op_failed(op);
+      continue;
+    }
+
+    future_t *future = async_shared(
+        pool,
+        (callable_t){.function = async_task, .arg = op, .argsz = sizeof(op_t)},
+        NULL);
+    if (!future) {
+      op_failed(op);
+      continue;
+    }
+    if (op->kind == OP_MAP) {
+      thread_pool_t *other = &producer->pools[rand_r(&producer->seed) % 2];
+      future_t *mapped = map_shared(other, future, map_task, NULL);
+      if (mapped)
+        future_unref(mapped);
+      else
+        op_failed(op);
+    }
+    future_unref(future);
+  }
+
+  return NULL;
+}
+
+// Aborts the run if no task completes within stall_ms while work is pending.
+static void *watchdog(void *arg __attribute__((unused))) {
+  size_t last = atomic_load(&completed);
+  uint64_t last_progress = now_ns();
+
+  while (!atomic_load(&finished)) {
+    usleep(10000);
+    size_t current = atomic_load(&completed);
+    if (current != last) {
+      last = current;
+      last_progress = now_ns();
+    } else if (now_ns() - last_progress > stall_ms * 1000000u) {
+      fprintf(stderr, "watchdog: no progress for %lu ms at %zu/%zu tasks\n",
+              stall_ms, current, nproducers * nops);
+      abort();
+    }
+  }
+
+  return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *sorted, size_t n, double p) {
+  return sorted[(size_t)(p * (n - 1))];
+}
+
+static char *test_stress() {
+  thread_pool_t pools[2];
+  thread_pool_init(&pools[0], POOL_SIZE);
+  thread_pool_init(&pools[1], POOL_SIZE);
+
+  producer_t *producers = malloc(nproducers * sizeof(producer_t));
+  pthread_t *threads = malloc(nproducers * sizeof(pthread_t));
+  op_t *ops = malloc(nproducers * nops * sizeof(op_t));
+  mu_assert("memory allocation error", producers && threads && ops);
+
+  atomic_store(&completed, 0);
+  atomic_store(&failed, 0);
+  atomic_store(&finished, 0);
+  pthread_t watchdog_thread;
+  pthread_create(&watchdog_thread, 0, watchdog, NULL);
+
+  for (size_t i = 0; i < nproducers; ++i) {
+    producers[i].seed = seed + i;
+    producers[i].ops = ops + i * nops;
+    producers[i].pools = pools;
+    sem_init(&producers[i].window, 0, WINDOW);
+    pthread_create(&threads[i], 0, produce, &producers[i]);
+  }
+
+  for (size_t i = 0; i < nproducers; ++i)
+    pthread_join(threads[i], 0);
+
+  thread_pool_destroy(&pools[0]);
+  thread_pool_destroy(&pools[1]);
+
+  atomic_store(&finished, 1);
+  pthread_join(watchdog_thread, 0);
+
+  size_t total = nproducers * nops;
+  mu_assert("expected every submission to succeed", atomic_load(&failed) == 0);
+  mu_assert("expected every task to complete",
+            atomic_load(&completed) == total);
+
+  uint64_t *latencies = malloc(total * sizeof(uint64_t));
+  mu_assert("memory allocation error", latencies);
+  for (size_t i = 0; i < total; ++i)
+    latencies[i] = ops[i].latency_ns;
+  qsort(latencies, total, sizeof(uint64_t), compare_u64);
+
+  uint64_t p99 = percentile(latencies, total, 0.99);
+  printf("seed %u: submit-to-start p50 %lu us, p99 %lu us, p999 %lu us\n",
+         seed, percentile(latencies, total, 0.5) / 1000, p99 / 1000,
+         percentile(latencies, total, 0.999) / 1000);
+
+  for (size_t i = 0; i < nproducers; ++i)
+    sem_destroy(&producers[i].window);
+  free(latencies);
+  free(ops);
+  free(threads);
+  free(producers);
+
+  mu_assert("p99 submit-to-start latency over budget",
+            p99 <= p99_budget_us * 1000);
+  return 0;
+}
+
+static char *all_tests() {
+  mu_run_test(test_stress);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1)
+    seed = strtoul(argv[1], NULL, 10);
+  if (argc > 2)
+    nproducers = strtoul(argv[2], NULL, 10);
+  if (argc > 3)
+    nops = strtoul(argv[3], NULL, 10);
+  if (argc > 4)
+    p99_budget_us = strtoull(argv[4], NULL, 10);
+  if (argc > 5)
+    stall_ms = strtoull(argv[5], NULL, 10);
+  if (!nproducers || !nops) {
+    fprintf(stderr, "test_stress: producers and ops must be positive\n");
+    return 1;
+  }
+
+  char *result = all_tests();
+  if (result != 0) {
+    printf(__FILE__ " %s\n", result);
+  } else {
+    printf(__FILE__ " ALL TESTS PASSED\n");
+  }
+  printf(__FILE__ " Tests run: %d\n", tests_run);
+
+  return result != 0;
+}
@@ -1,5 +1,7 @@
 #include "threadpool.h"
 #include "err.h"
+#include "future.h"
+#include "reactor.h"
 #include <stdio.h>
 #include <signal.h>
 
@@ -69,23 +71,43 @@ int get_no_defer() {
     return retval;
 }
 
+int thread_pool_is_empty(thread_pool_t *pool) {
+    return !pool->tasks_head && list_is_empty(&pool->task_queue);
+}
+
+// Takes the next task off either queue, with the pool lock held. Returns 0 if both are empty.
+int thread_pool_next(thread_pool_t *pool, runnable_t *runnable) {
+    task_t *task = pool->tasks_head;
+    if (task) {
+        pool->tasks_head = task->next;
+        if (!pool->tasks_head) pool->tasks_tail = NULL;
+        *runnable = task->runnable;
+        return 1;
+    }
+
+    runnable_t *queued = (runnable_t *) list_pop_front(&pool->task_queue);
+    if (!queued) return 0;
+
+    *runnable = *queued;
+    free(queued);
+    return 1;
+}
+
 void thread_pool_work(void *data) {
     if (pthread_sigmask(SIG_BLOCK, &block_mask, 0) != 0) syserr("pthread_sigmask error/n");
     thread_pool_t *pool = (thread_pool_t *) data;
 
     if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
 
-    while (!(pool->terminate || get_no_defer()) || !list_is_empty(&pool->task_queue)) {
-        while (!(pool->terminate || get_no_defer()) && list_is_empty(&pool->task_queue)) {
+    while (!(pool->terminate || get_no_defer()) || !thread_pool_is_empty(pool)) {
+        while (!(pool->terminate || get_no_defer()) && thread_pool_is_empty(pool)) {
             if (pthread_cond_wait(&pool->idle, &pool->lock) != 0) syserr("pthread_cond_wait error\n");
         }
-        runnable_t *runnable = (runnable_t *) list_pop_front(&pool->task_queue);
+        runnable_t runnable;
+        int found = thread_pool_next(pool, &runnable);
         if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
 
-        if (runnable) {
-            runnable->function(runnable->arg, runnable->argsz);
-            free(runnable);
-        }
+        if (found) runnable.function(runnable.arg, runnable.argsz);
 
         if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
     }
@@ -96,13 +118,24 @@ void thread_pool_work(void *data) {
 int thread_pool_init(thread_pool_t *pool, size_t num_threads) {
     if (pthread_mutex_init(&pool->lock, 0) != 0) syserr("pthread_mutex_init error\n");
     if (pthread_cond_init(&pool->idle, 0) != 0) syserr("pthread_cond_init error\n");
+    if (pthread_cond_init(&pool->released, 0) != 0) syserr("pthread_cond_init error\n");
     pool->terminate = 0;
+    pool->retained = 0;
+    pool->closing = 0;
     pool->num_threads = num_threads;
+    pool->reactor = NULL;
+
+    pool->future_cache = future_cache_create();
+    if (!pool->future_cache) return -1;
 
     pool->threads = malloc(sizeof(pthread_t) * num_threads);
-    if (!pool->threads) return -1;
+    if (!pool->threads) {
+        future_cache_close(pool->future_cache);
+        return -1;
+    }
 
     list_init(&pool->task_queue);
+    pool->tasks_head = pool->tasks_tail = NULL;
 
     for (size_t i = 0; i < num_threads; i++) {
         if (pthread_create(&pool->threads[i], 0, (void *) thread_pool_work, pool) != 0)
@@ -127,6 +160,21 @@ void thread_pool_stop(thread_pool_t *pool) {
 }
 
 void thread_pool_destroy(thread_pool_t *pool) {
+    // New I/O requests fail from here on, and the reactor is detached under the lock so that none can still reach it.
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+    pool->closing = 1;
+    reactor_t *reactor = pool->reactor;
+    pool->reactor = NULL;
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    if (reactor) reactor_destroy(reactor);
+
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+    while (pool->retained) {
+        if (pthread_cond_wait(&pool->released, &pool->lock) != 0) syserr("pthread_cond_wait error\n");
+    }
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
     thread_pool_stop(pool);
     list_erase(&threadpool_list, pool);
 
@@ -134,25 +182,20 @@ void thread_pool_destroy(thread_pool_t *pool) {
         if (pthread_join(pool->threads[i], 0) != 0) syserr("pthread_join error\n");
     }
 
+    if (pthread_cond_destroy(&pool->released) != 0) syserr("pthread_cond_destroy error\n");
     if (pthread_cond_destroy(&pool->idle) != 0) syserr("pthread_cond_destroy error\n");
     if (pthread_mutex_destroy(&pool->lock) != 0) syserr("pthread_mutex_destroy error\n");
 
+    future_cache_close(pool->future_cache);
+
     list_destroy(&pool->task_queue);
     free(pool->threads);
 }
 
-int thread_pool_terminated(thread_pool_t *pool) {
-    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
-
-    int terminated = pool->terminate;
-
-    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
-
-    return terminated;
-}
-
+// The task is queued and the signal sent while holding the pool lock; otherwise a worker that has just seen an empty
+// queue could miss the signal before it starts waiting on idle.
 int defer(struct thread_pool *pool, runnable_t runnable) {
-    if (get_no_defer() || thread_pool_terminated(pool)) return -1;
+    if (get_no_defer()) return -1;
 
     runnable_t *task = malloc(sizeof(runnable_t));
     if (!task) return -1;
@@ -161,11 +204,54 @@ int defer(struct thread_pool *pool, runnable_t runnable) {
     task->arg = runnable.arg;
     task->argsz = runnable.argsz;
 
-    if (list_push_back(&pool->task_queue, (void *) task) != 0) {
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (pool->terminate || list_push_back(&pool->task_queue, (void *) task) != 0) {
+        if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
         free(task);
         return -1;
     }
     if (pthread_cond_signal(&pool->idle) != 0) syserr("pthread_cond_signal error\n");
 
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
+    return 0;
+}
+
+int defer_task(thread_pool_t *pool, task_t *task) {
+    if (get_no_defer()) return -1;
+
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+
+    if (pool->terminate) {
+        if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+        return -1;
+    }
+
+    task->next = NULL;
+    if (pool->tasks_tail) {
+        pool->tasks_tail->next = task;
+    } else {
+        pool->tasks_head = task;
+    }
+    pool->tasks_tail = task;
+    if (pthread_cond_signal(&pool->idle) != 0) syserr("pthread_cond_signal error\n");
+
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+
     return 0;
 }
+
+void thread_pool_retain(thread_pool_t *pool) {
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+    pool->retained++;
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
+
+void thread_pool_release(thread_pool_t *pool) {
+    if (pthread_mutex_lock(&pool->lock) != 0) syserr("pthread_mutex_lock error\n");
+    if (--pool->retained == 0) {
+        if (pthread_cond_broadcast(&pool->released) != 0) syserr("pthread_cond_broadcast error\n");
+    }
+    if (pthread_mutex_unlock(&pool->lock) != 0) syserr("pthread_mutex_unlock error\n");
+}
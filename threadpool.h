@@ -12,13 +12,28 @@ typedef struct runnable {
   size_t argsz;
 } runnable_t;
 
+typedef struct task {
+  runnable_t runnable;
+  struct task *next;
+} task_t;
+
+struct reactor;
+struct future_cache;
+
 typedef struct thread_pool {
     pthread_t *threads;
     volatile size_t num_threads;
     volatile int8_t terminate;
+    int8_t closing;
     pthread_mutex_t lock;
     pthread_cond_t idle;
+    size_t retained;
+    pthread_cond_t released;
     list_t task_queue;
+    task_t *tasks_head;
+    task_t *tasks_tail;
+    struct reactor *reactor;
+    struct future_cache *future_cache;
 } thread_pool_t;
 
 int thread_pool_init(thread_pool_t *pool, size_t pool_size);
@@ -27,4 +42,13 @@ void thread_pool_destroy(thread_pool_t *pool);
 
 int defer(thread_pool_t *pool, runnable_t runnable);
 
+// Like defer, but queues task itself instead of allocating a copy. The task must stay valid until it has started.
+int defer_task(thread_pool_t *pool, task_t *task);
+
+// A retained pool is expected to receive a task later, e.g. a map waiting for its source; thread_pool_destroy waits
+// for every retain to be released before it stops accepting tasks.
+void thread_pool_retain(thread_pool_t *pool);
+
+void thread_pool_release(thread_pool_t *pool);
+
 #endif